@@ -0,0 +1,344 @@
+#include "blit.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace TUI;
+
+
+// Opens a file of PPM frames
+FrameReader::FrameReader(std::string path)
+    : FrameReader(path,0,0)
+{
+    ppm = true;
+}
+
+// Opens a file of headerless frames with the given dimensions
+FrameReader::FrameReader(std::string path, size_t width, size_t height)
+    : fd(open(path.c_str(),O_RDONLY))
+    , owns_fd(true)
+    , mapping(nullptr)
+    , mapping_size(0)
+    , mapping_offset(0)
+    , ppm(false)
+    , maxval(255)
+    , width(width)
+    , height(height)
+    , pixels(nullptr)
+{
+    if (fd == -1) {
+        throw std::runtime_error("Could not open \"" + path + "\": " + strerror(errno));
+    }
+    map();
+}
+
+// Reads PPM frames from an open file descriptor, such as a pipe
+FrameReader::FrameReader(int fd)
+    : FrameReader(fd,0,0)
+{
+    ppm = true;
+}
+
+// Reads headerless frames with the given dimensions from an open file
+// descriptor, such as a pipe
+FrameReader::FrameReader(int fd, size_t width, size_t height)
+    : fd(fd)
+    , owns_fd(false)
+    , mapping(nullptr)
+    , mapping_size(0)
+    , mapping_offset(0)
+    , ppm(false)
+    , maxval(255)
+    , width(width)
+    , height(height)
+    , pixels(nullptr)
+{
+    map();
+}
+
+FrameReader::~FrameReader() {
+    if (mapping != nullptr) {
+        munmap((void*) mapping,mapping_size);
+    }
+    if (owns_fd) {
+        close(fd);
+    }
+}
+
+
+// Maps the file descriptor into memory if it refers to a regular file,
+// leaving `mapping` null so that it gets read as a stream otherwise
+void FrameReader::map() {
+    struct stat info;
+    if ( (fstat(fd,&info) == -1) || !S_ISREG(info.st_mode) || (info.st_size == 0) ) {
+        return;
+    }
+    void *address = mmap(nullptr,info.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+    if (address == MAP_FAILED) {
+        return;
+    }
+    // Frames are read front to back
+    madvise(address,info.st_size,MADV_SEQUENTIAL);
+    mapping      = (uint8_t const*) address;
+    mapping_size = info.st_size;
+}
+
+
+// Reads exactly `size` bytes, returning false if the input ends first
+bool FrameReader::read_fully(uint8_t *destination, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+        ssize_t count = read(fd,destination+total,size-total);
+        if ( (count == -1) && (errno == EINTR) ) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        total += count;
+    }
+    return true;
+}
+
+
+bool FrameReader::read_byte(uint8_t &byte) {
+    if (mapping != nullptr) {
+        if (mapping_offset >= mapping_size) {
+            return false;
+        }
+        byte = mapping[mapping_offset++];
+        return true;
+    }
+    return read_fully(&byte,1);
+}
+
+
+// Parses a binary PPM header ("P6 <width> <height> <maxval>"), leaving
+// the input positioned at the first byte of pixel data. Returns false if
+// the input ended before another frame began.
+bool FrameReader::read_ppm_header() {
+    uint8_t byte;
+    if ( !read_byte(byte) ) {
+        return false;
+    }
+    uint8_t format;
+    if ( (byte != 'P') || !read_byte(format) || (format != '6') ) {
+        throw std::runtime_error("FrameReader expected a binary (P6) PPM header");
+    }
+
+    // Width, height, and maxval, separated by whitespace and comments
+    size_t fields[3] = {0,0,0};
+    for (size_t &field : fields) {
+        bool digits = false;
+        while (true) {
+            if ( !read_byte(byte) ) {
+                throw std::runtime_error("FrameReader found a truncated PPM header");
+            }
+            if (byte == '#') {
+                // Comments count as whitespace, so they can end a field
+                while ( read_byte(byte) && (byte != '\n') ) {}
+                if (digits) {
+                    break;
+                }
+            } else if ( (byte >= '0') && (byte <= '9') ) {
+                field  = field*10 + (byte - '0');
+                digits = true;
+            } else if (digits) {
+                // The single whitespace byte after maxval has now been
+                // consumed, so the pixel data starts with the next byte
+                break;
+            }
+        }
+    }
+    if ( (fields[0] == 0) || (fields[1] == 0) || (fields[2] == 0) ) {
+        throw std::runtime_error("FrameReader found a PPM header with a zero width, height, or maxval");
+    }
+    if (fields[2] > 255) {
+        throw std::runtime_error("FrameReader only supports 8-bit PPM frames");
+    }
+    width  = fields[0];
+    height = fields[1];
+    maxval = fields[2];
+    return true;
+}
+
+
+// Stretches samples from 0..maxval to 0..255, writing them to `buffer`.
+// `source` may be the buffer itself.
+void FrameReader::rescale(uint8_t const *source, size_t size) {
+    uint8_t table[256];
+    for (size_t value=0; value<256; value++) {
+        table[value] = std::min(value,maxval) * 255 / maxval;
+    }
+    buffer.resize(size);
+    for (size_t i=0; i<size; i++) {
+        buffer[i] = table[source[i]];
+    }
+    pixels = buffer.data();
+}
+
+
+// Advances to the next frame, returning false once the input runs out
+bool FrameReader::next() {
+    if ( ppm && !read_ppm_header() ) {
+        return false;
+    }
+    if ( (width == 0) || (height == 0) ) {
+        throw std::runtime_error("FrameReader can't read frames with a zero width or height");
+    }
+    size_t size = width*height*3;
+    if (mapping != nullptr) {
+        if (mapping_offset+size > mapping_size) {
+            return false;
+        }
+        pixels = mapping + mapping_offset;
+        mapping_offset += size;
+    } else {
+        buffer.resize(size);
+        if ( !read_fully(buffer.data(),size) ) {
+            return false;
+        }
+        pixels = buffer.data();
+    }
+    if (maxval != 255) {
+        rescale(pixels,size);
+    }
+    return true;
+}
+
+uint8_t const* FrameReader::get_pixels() {
+    return pixels;
+}
+
+size_t FrameReader::get_width() {
+    return width;
+}
+
+size_t FrameReader::get_height() {
+    return height;
+}
+
+
+
+Blitter::Blitter(bool half_block)
+    : half_block(half_block)
+    , source_width(0)
+    , source_height(0)
+    , target_width(0)
+    , target_height(0)
+{}
+
+
+// Splits `source` pixels into `target` spans as evenly as possible. When
+// upscaling, spans are one pixel wide and repeat.
+static void build_spans(std::vector<uint32_t> &spans, size_t source, size_t target) {
+    spans.resize(target+1);
+    for (size_t i=0; i<target; i++) {
+        spans[i] = (uint64_t) i * source / target;
+    }
+    spans[target] = source;
+}
+
+
+// Rebuilds the scaling tables, but only if the dimensions have changed
+// since the last frame
+void Blitter::plan(size_t width, size_t height, size_t canvas_width, size_t canvas_height) {
+    size_t pixel_rows = half_block ? canvas_height*2 : canvas_height;
+    if (    (width  == source_width ) && (height     == source_height)
+         && (canvas_width == target_width) && (pixel_rows == target_height) ) {
+        return;
+    }
+    source_width  = width;
+    source_height = height;
+    target_width  = canvas_width;
+    target_height = pixel_rows;
+    build_spans(column_spans,width, canvas_width);
+    build_spans(row_spans,   height,pixel_rows);
+    row_sums.resize(width*3);
+    scaled.resize(canvas_width*pixel_rows*3);
+}
+
+
+// Scales an image down (by averaging) or up (by repetition) to the pixel
+// grid of a canvas, storing the result in `scaled`.
+//
+// The inner loops run over contiguous arrays of plain integers with no
+// branches, which is the form the compiler turns into SIMD code.
+void Blitter::scale(
+    uint8_t const *pixels, size_t width, size_t height,
+    size_t canvas_width, size_t canvas_height
+) {
+    if ( (width == 0) || (height == 0) ) {
+        throw std::runtime_error("Blitter can't scale an image with a zero width or height");
+    }
+    plan(width,height,canvas_width,canvas_height);
+    size_t row_bytes = width*3;
+    uint32_t *sums = row_sums.data();
+
+    for (size_t y=0; y<target_height; y++) {
+        uint32_t row_start = row_spans[y];
+        uint32_t row_end   = std::max(row_spans[y+1],row_start+1);
+
+        // Sum the band of source rows, channel by channel
+        uint8_t const *row = pixels + row_start*row_bytes;
+        for (size_t i=0; i<row_bytes; i++) {
+            sums[i] = row[i];
+        }
+        for (uint32_t source_y=row_start+1; source_y<row_end; source_y++) {
+            row = pixels + source_y*row_bytes;
+            for (size_t i=0; i<row_bytes; i++) {
+                sums[i] += row[i];
+            }
+        }
+
+        // Then average each destination pixel's span of the band
+        uint8_t *out = scaled.data() + y*target_width*3;
+        for (size_t x=0; x<target_width; x++) {
+            uint32_t column_start = column_spans[x];
+            uint32_t column_end   = std::max(column_spans[x+1],column_start+1);
+            uint32_t red = 0, green = 0, blue = 0;
+            for (uint32_t source_x=column_start; source_x<column_end; source_x++) {
+                red   += sums[source_x*3  ];
+                green += sums[source_x*3+1];
+                blue  += sums[source_x*3+2];
+            }
+            uint32_t count = (row_end-row_start) * (column_end-column_start);
+            out[x*3  ] = red   / count;
+            out[x*3+1] = green / count;
+            out[x*3+2] = blue  / count;
+        }
+    }
+}
+
+
+// Scales an image to fit the canvas and writes it into the canvas' tiles
+void Blitter::blit(uint8_t const *pixels, size_t width, size_t height, Canvas &canvas) {
+    size_t canvas_width  = canvas.get_width();
+    size_t canvas_height = canvas.get_height();
+    scale(pixels,width,height,canvas_width,canvas_height);
+
+    std::string const symbol = half_block ? "▀" : " ";
+    size_t row_bytes = canvas_width*3;
+    for (size_t y=0; y<canvas_height; y++) {
+        // In half-block mode, each row of tiles covers two pixel rows
+        uint8_t const *top    = scaled.data() + (half_block ? y*2 : y)*row_bytes;
+        uint8_t const *bottom = half_block ? top + row_bytes : top;
+        for (size_t x=0; x<canvas_width; x++) {
+            Tile &tile = canvas(x,y);
+            // Only touch the symbol when it actually changes, so steady
+            // streaming doesn't keep reallocating strings
+            if (tile.symbol != symbol) {
+                tile.symbol = symbol;
+            }
+            tile.fore_color = RGB{top[x*3],   top[x*3+1],   top[x*3+2]   };
+            tile.back_color = RGB{bottom[x*3],bottom[x*3+1],bottom[x*3+2]};
+        }
+    }
+}
+
+
+void Blitter::blit(FrameReader &reader, Canvas &canvas) {
+    blit(reader.get_pixels(),reader.get_width(),reader.get_height(),canvas);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include "tui.h"
+
+namespace TUI {
+
+// Reads a sequence of 24-bit RGB frames, either as binary PPM images
+// (eg: `ffmpeg ... -f image2pipe -vcodec ppm -`) or as headerless frames
+// of a known size. Files are memory-mapped, so their frames are handed out
+// without being copied. Anything else (pipes, stdin) is read into a buffer
+// that is reused from frame to frame.
+class FrameReader {
+
+    int  fd;
+    bool owns_fd;
+
+    // The mapped file, and how far into it the next frame starts
+    uint8_t const *mapping;
+    size_t mapping_size;
+    size_t mapping_offset;
+
+    // Holds the current frame when reading from a stream
+    std::vector<uint8_t> buffer;
+
+    // Whether frames are preceded by PPM headers
+    bool ppm;
+
+    // The brightest sample value of the current frame. Frames with a
+    // maxval other than 255 are rescaled into `buffer` as they are read.
+    size_t maxval;
+
+    size_t width;
+    size_t height;
+    uint8_t const *pixels;
+
+    void map();
+    bool read_fully(uint8_t *destination, size_t size);
+    bool read_byte(uint8_t &byte);
+    bool read_ppm_header();
+    void rescale(uint8_t const *source, size_t size);
+
+    public:
+
+    FrameReader(std::string path);
+    FrameReader(std::string path, size_t width, size_t height);
+    FrameReader(int fd);
+    FrameReader(int fd, size_t width, size_t height);
+    ~FrameReader();
+
+    FrameReader(FrameReader const&) = delete;
+    FrameReader& operator=(FrameReader const&) = delete;
+
+    bool next();
+
+    uint8_t const* get_pixels();
+    size_t get_width();
+    size_t get_height();
+};
+
+
+// Scales RGB images to fit a canvas and writes them into its tiles. In
+// half-block mode, each tile shows two vertically stacked pixels by drawing
+// "▀" with the top pixel as its foreground and the bottom pixel as its
+// background, doubling the vertical resolution for the same number of
+// tiles.
+class Blitter {
+
+    bool half_block;
+
+    // The source and destination dimensions the scaling tables were
+    // built for
+    size_t source_width;
+    size_t source_height;
+    size_t target_width;
+    size_t target_height;
+
+    // For each destination column and row, the range of source columns or
+    // rows averaged together to produce it, stored as start offsets with a
+    // trailing end offset
+    std::vector<uint32_t> column_spans;
+    std::vector<uint32_t> row_spans;
+
+    // Per-channel sums of one band of source rows
+    std::vector<uint32_t> row_sums;
+
+    // The scaled image, three bytes per pixel
+    std::vector<uint8_t> scaled;
+
+    void plan(size_t width, size_t height, size_t canvas_width, size_t canvas_height);
+
+    public:
+
+    Blitter(bool half_block = false);
+
+    void scale(uint8_t const *pixels, size_t width, size_t height, size_t canvas_width, size_t canvas_height);
+    void blit(uint8_t const *pixels, size_t width, size_t height, Canvas &canvas);
+    void blit(FrameReader &reader, Canvas &canvas);
+};
+
+};
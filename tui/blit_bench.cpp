@@ -0,0 +1,51 @@
+#include <chrono>
+#include "blit.h"
+
+// Measures how long it takes to convert frames of RGB pixels into canvas
+// tiles, not counting reading the frames or displaying the canvas.
+
+int const CANVAS_WIDTH  = 200;
+int const CANVAS_HEIGHT = 100;
+int const FRAME_WIDTH   = 640;
+int const FRAME_HEIGHT  = 480;
+int const FRAME_COUNT   = 8;
+int const REPEATS       = 300;
+
+// Fills a frame with a moving pattern, loosely resembling a heatmap
+void synthesize(std::vector<uint8_t> &frame, int phase) {
+    for (int y=0; y<FRAME_HEIGHT; y++) {
+        for (int x=0; x<FRAME_WIDTH; x++) {
+            uint8_t *pixel = &frame[(y*FRAME_WIDTH+x)*3];
+            int heat = (x*x + y*y + phase*4096) >> 10;
+            pixel[0] = heat;
+            pixel[1] = heat >> 1;
+            pixel[2] = 255 - heat;
+        }
+    }
+}
+
+void bench(char const *name, bool half_block, std::vector<std::vector<uint8_t>> &frames) {
+    TUI::Canvas  canvas(CANVAS_WIDTH,CANVAS_HEIGHT);
+    TUI::Blitter blitter(half_block);
+    auto start = std::chrono::steady_clock::now();
+    for (int i=0; i<REPEATS; i++) {
+        blitter.blit(frames[i%FRAME_COUNT].data(),FRAME_WIDTH,FRAME_HEIGHT,canvas);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double per_frame = elapsed.count() / REPEATS;
+    std::cout << name << ": "
+              << per_frame * 1e3 << " ms per frame ("
+              << 1.0 / per_frame << " fps) converting "
+              << FRAME_WIDTH << 'x' << FRAME_HEIGHT << " to "
+              << CANVAS_WIDTH << 'x' << CANVAS_HEIGHT << " tiles\n";
+}
+
+int main() {
+    std::vector<std::vector<uint8_t>> frames(FRAME_COUNT);
+    for (int i=0; i<FRAME_COUNT; i++) {
+        frames[i].resize(FRAME_WIDTH*FRAME_HEIGHT*3);
+        synthesize(frames[i],i);
+    }
+    bench("full block",false,frames);
+    bench("half block",true, frames);
+}
@@ -0,0 +1,103 @@
+#include <chrono>
+#include "vt.h"
+
+// Replays a series of frames through a virtual terminal, checking after
+// every frame that the screen matches the canvas, then reports how many
+// bytes and escape sequences the display functions needed along the way.
+// Any change to how canvases encode their output should keep this passing
+// and, ideally, drive the numbers down.
+
+int const WIDTH  = 64;
+int const HEIGHT = 32;
+int const FRAMES = 200;
+
+// Draws one frame of a scene with a mix of small, scattered changes
+// (like snake) and larger changes (like an animation)
+void draw_frame(TUI::Canvas &canvas, int frame) {
+    // A band of color sweeping across the canvas. Like everything else
+    // here, it is two columns wide so that it never covers only half of a
+    // double-width symbol, which no terminal could display.
+    int band = (frame % (WIDTH/2)) * 2;
+    for (int y=0; y<HEIGHT; y++) {
+        TUI::Tile tile = TUI::Tile{TUI::RGB{
+            (uint8_t) (frame*3),
+            (uint8_t) (y*8),
+            (uint8_t) (255-frame)
+        }};
+        canvas(band,y)   = tile;
+        canvas(band+1,y) = tile;
+    }
+
+    // A handful of scattered glyphs, some of them double-width
+    for (int i=0; i<8; i++) {
+        int x = (rand() % (WIDTH/2)) * 2;
+        int y = rand() % HEIGHT;
+        switch (rand() % 3) {
+            case 0:
+                canvas(x,y)   = TUI::Tile{"🟩",TUI::RGB{0,0,0},TUI::RGB{0,0,0}};
+                canvas(x+1,y) = TUI::Tile{TUI::RGB{0,0,0}};
+            break;
+            case 1:
+                canvas(x,y) = TUI::Tile{
+                    std::string(1,'a'+rand()%26),
+                    TUI::RGB{255,255,255},
+                    TUI::RGB{0,0,64}
+                };
+            break;
+            default:
+                canvas(x,y)   = TUI::Tile{TUI::RGB{0,0,0}};
+                canvas(x+1,y) = TUI::Tile{TUI::RGB{0,0,0}};
+            break;
+        }
+    }
+}
+
+int main() {
+
+    TUI::Canvas canvas(WIDTH,HEIGHT,4,4);
+    for (int y=0; y<HEIGHT; y++) {
+        for (int x=0; x<WIDTH; x++) {
+            canvas(x,y) = TUI::RGB{0,0,0};
+        }
+    }
+
+    TUI::VirtualTerminal terminal(WIDTH+8,HEIGHT+8);
+    terminal.feed(TUI::VirtualTerminal::capture([&](){ canvas.full_display(); }));
+    terminal.verify(canvas);
+    TUI::VirtualTerminal::Score full = terminal.score();
+    terminal.reset_score();
+
+    srand(0);
+    std::chrono::duration<double> encode_time(0);
+    for (int frame=0; frame<FRAMES; frame++) {
+        draw_frame(canvas,frame);
+        auto start = std::chrono::steady_clock::now();
+        std::string output = TUI::VirtualTerminal::capture([&](){ canvas.lazy_display(); });
+        encode_time += std::chrono::steady_clock::now() - start;
+        terminal.feed(output);
+        std::string problem = terminal.diff(canvas);
+        if ( !problem.empty() ) {
+            std::cerr << "Frame " << frame << ": " << problem << '\n';
+            return 1;
+        }
+    }
+    TUI::VirtualTerminal::Score lazy = terminal.score();
+
+    std::cout << "full_display : "
+              << full.bytes   << " bytes, "
+              << full.escapes << " escapes ("
+              << full.color_escapes << " color, "
+              << full.move_escapes  << " movement), "
+              << full.symbols << " symbols\n";
+    std::cout << "lazy_display : "
+              << lazy.bytes   << " bytes, "
+              << lazy.escapes << " escapes ("
+              << lazy.color_escapes << " color, "
+              << lazy.move_escapes  << " movement), "
+              << lazy.symbols << " symbols over "
+              << lazy.frames  << " frames\n";
+    std::cout << "per frame    : "
+              << lazy.bytes   / lazy.frames << " bytes, "
+              << lazy.escapes / lazy.frames << " escapes, "
+              << encode_time.count() * 1e6 / lazy.frames << " us to encode\n";
+}
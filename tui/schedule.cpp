@@ -0,0 +1,209 @@
+#include "schedule.h"
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/timerfd.h>
+
+using namespace TUI;
+
+
+FrameScheduler::FrameScheduler(
+    std::chrono::nanoseconds tick,
+    Overrun policy,
+    size_t catch_up_limit
+)
+    : timer_fd(timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC))
+    , tick(tick)
+    , policy(policy)
+    , catch_up_limit(std::max(catch_up_limit,(size_t)1))
+    , deadlines_passed(0)
+    , input_is_ready(false)
+    , in_frame(false)
+    , tally{}
+    , total_budget(0)
+    , total_jitter(0)
+{
+    clock_gettime(CLOCK_MONOTONIC,&start);
+
+    // Without a timerfd, `wait` falls back to sleeping with
+    // clock_nanosleep, which can't also watch for input
+    if (timer_fd == -1) {
+        return;
+    }
+    itimerspec timer = {};
+    timer.it_value = deadline(1);
+    timer.it_interval.tv_sec  = tick.count() / 1000000000;
+    timer.it_interval.tv_nsec = tick.count() % 1000000000;
+    if (timerfd_settime(timer_fd,TFD_TIMER_ABSTIME,&timer,nullptr) == -1) {
+        close(timer_fd);
+        timer_fd = -1;
+    }
+}
+
+FrameScheduler::~FrameScheduler() {
+    if (timer_fd != -1) {
+        close(timer_fd);
+    }
+}
+
+
+// The absolute time of the index'th deadline after the start time
+timespec FrameScheduler::deadline(uint64_t index) {
+    int64_t offset = tick.count() * index + start.tv_nsec;
+    timespec result;
+    result.tv_sec  = start.tv_sec + offset / 1000000000;
+    result.tv_nsec = offset % 1000000000;
+    return result;
+}
+
+
+// Blocks until at least one deadline passes or input becomes readable,
+// returning how many deadlines passed
+uint64_t FrameScheduler::expirations(int input_fd) {
+    if (timer_fd == -1) {
+        timespec next = deadline(deadlines_passed+1);
+        while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&next,nullptr) == EINTR) {}
+        // Work out how many deadlines have gone by, in case we overslept
+        timespec now;
+        clock_gettime(CLOCK_MONOTONIC,&now);
+        int64_t elapsed = (now.tv_sec - start.tv_sec) * 1000000000 + (now.tv_nsec - start.tv_nsec);
+        return elapsed / tick.count() - deadlines_passed;
+    }
+
+    pollfd fds[2] = {
+        {timer_fd,POLLIN,0},
+        {input_fd,POLLIN,0},
+    };
+    nfds_t count = (input_fd == -1) ? 1 : 2;
+    while (poll(fds,count,-1) == -1) {
+        if (errno != EINTR) {
+            throw std::runtime_error(std::string("FrameScheduler could not poll: ") + strerror(errno));
+        }
+    }
+    input_is_ready = (count == 2) && (fds[1].revents & (POLLIN | POLLHUP));
+    if ( !(fds[0].revents & POLLIN) ) {
+        return 0;
+    }
+    uint64_t passed = 0;
+    if (read(timer_fd,&passed,sizeof(passed)) != sizeof(passed)) {
+        return 0;
+    }
+    return passed;
+}
+
+
+// Blocks until the next tick is due or `input_fd` (if given) has input to
+// read, and returns how many logic ticks should be run. This is zero when
+// only input woke the scheduler, and can be more than one after an overrun
+// if the policy is CATCH_UP.
+size_t FrameScheduler::wait(int input_fd) {
+    end_frame();
+    input_is_ready = false;
+
+    uint64_t passed = expirations(input_fd);
+    auto now = std::chrono::steady_clock::now();
+    frame_start = now;
+    last_mark   = now;
+    if (passed == 0) {
+        return 0;
+    }
+    // Only frames that run ticks count towards the budget
+    in_frame = true;
+
+    // Measure how late we woke up relative to the latest deadline passed
+    deadlines_passed += passed;
+    timespec latest = deadline(deadlines_passed);
+    timespec woke;
+    clock_gettime(CLOCK_MONOTONIC,&woke);
+    std::chrono::nanoseconds jitter(
+          (woke.tv_sec - latest.tv_sec) * 1000000000
+        + (woke.tv_nsec - latest.tv_nsec)
+    );
+    jitter = std::max(jitter,std::chrono::nanoseconds(0));
+    total_jitter += jitter;
+    tally.peak_jitter = std::max(tally.peak_jitter,jitter);
+
+    size_t ticks = (policy == SKIP) ? 1 : std::min((size_t)passed,catch_up_limit);
+    tally.frames++;
+    tally.ticks += ticks;
+    tally.dropped_ticks += passed - ticks;
+    return ticks;
+}
+
+
+// Whether input was readable when `wait` last returned
+bool FrameScheduler::input_ready() {
+    return input_is_ready;
+}
+
+
+// Attributes the time since the previous mark (or since `wait` returned)
+// to the given phase of the current frame. Like the budget, this is only
+// recorded for frames that ran ticks, so that it averages over the same
+// frames that `report` divides by.
+void FrameScheduler::mark(Phase phase) {
+    auto now = std::chrono::steady_clock::now();
+    if (in_frame) {
+        tally.phase_time[phase] += now - last_mark;
+    }
+    last_mark = now;
+}
+
+
+// Records how much of a tick the frame that just finished used up
+void FrameScheduler::end_frame() {
+    if ( !in_frame ) {
+        return;
+    }
+    in_frame = false;
+    auto work = std::chrono::steady_clock::now() - frame_start;
+    double budget = (double) work.count() / tick.count();
+    total_budget += budget;
+    tally.peak_budget = std::max(tally.peak_budget,budget);
+    if (work > tick) {
+        tally.overruns++;
+    }
+}
+
+
+// The timer's file descriptor, for programs that would rather poll it
+// alongside their own descriptors. It is -1 if no timerfd is available.
+int FrameScheduler::get_fd() {
+    return timer_fd;
+}
+
+
+FrameScheduler::Stats FrameScheduler::stats() {
+    Stats result = tally;
+    size_t frames = std::max(tally.frames,(size_t)1);
+    result.mean_budget = total_budget / frames;
+    result.mean_jitter = total_jitter / frames;
+    return result;
+}
+
+
+// Summarizes the stats in a human-readable form
+std::string FrameScheduler::report() {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    Stats current = stats();
+    char const *names[PHASE_COUNT] = {"logic","encode","write"};
+    std::stringstream ss;
+    ss << current.frames << " frames, "
+       << current.ticks  << " ticks ("
+       << current.dropped_ticks << " dropped), "
+       << current.overruns << " overruns\r\n";
+    ss << "budget used: "
+       << (int) (current.mean_budget * 100) << "% mean, "
+       << (int) (current.peak_budget * 100) << "% peak\r\n";
+    ss << "jitter: "
+       << duration_cast<microseconds>(current.mean_jitter).count() << "us mean, "
+       << duration_cast<microseconds>(current.peak_jitter).count() << "us peak\r\n";
+    for (int phase=0; phase<PHASE_COUNT; phase++) {
+        size_t frames = std::max(current.frames,(size_t)1);
+        ss << names[phase] << ": "
+           << duration_cast<microseconds>(current.phase_time[phase]).count() / frames
+           << "us per frame\r\n";
+    }
+    return ss.str();
+}
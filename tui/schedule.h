@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <time.h>
+#include "tui.h"
+
+namespace TUI {
+
+// Runs fixed-rate logic ticks against absolute deadlines, so the tick
+// rate doesn't drift with however long rendering and output take. Ticks
+// are driven by a timerfd, which lets `wait` sleep on the timer and on
+// input at the same time, so programs don't need a separate input thread.
+//
+// A typical loop looks like:
+//
+//     while (!done) {
+//         size_t ticks = scheduler.wait(STDIN_FILENO);
+//         if (scheduler.input_ready()) { /* read input */ }
+//         for (size_t i=0; i<ticks; i++) { /* advance game state */ }
+//         scheduler.mark(FrameScheduler::LOGIC);
+//         if (ticks > 0) { /* render */ }
+//     }
+class FrameScheduler {
+
+    public:
+
+    // What to do when the program falls behind by more than one tick
+    enum Overrun {
+        // Run the missed ticks (up to a limit) to keep logic time in step
+        // with real time
+        CATCH_UP,
+        // Run a single tick and forget about the missed ones
+        SKIP,
+    };
+
+    // The parts of a frame that time is attributed to by `mark`
+    enum Phase {
+        LOGIC,
+        ENCODE,
+        WRITE,
+        PHASE_COUNT,
+    };
+
+    struct Stats {
+        size_t frames;
+        size_t ticks;
+        size_t dropped_ticks;
+
+        // Frames whose work took longer than a tick
+        size_t overruns;
+
+        // Total time spent in each phase
+        std::chrono::nanoseconds phase_time[PHASE_COUNT];
+
+        // The fraction of a tick spent working, per frame
+        double mean_budget;
+        double peak_budget;
+
+        // How late the scheduler woke up relative to each deadline
+        std::chrono::nanoseconds mean_jitter;
+        std::chrono::nanoseconds peak_jitter;
+    };
+
+    private:
+
+    int timer_fd;
+    std::chrono::nanoseconds tick;
+    Overrun policy;
+    size_t catch_up_limit;
+
+    // Deadlines are counted from the start time, rather than from the
+    // previous deadline, to avoid accumulating rounding error
+    timespec start;
+    uint64_t deadlines_passed;
+
+    bool input_is_ready;
+
+    // When the current frame's work began, and when its last phase ended
+    std::chrono::steady_clock::time_point frame_start;
+    std::chrono::steady_clock::time_point last_mark;
+    bool in_frame;
+
+    Stats tally;
+    double total_budget;
+    std::chrono::nanoseconds total_jitter;
+
+    timespec deadline(uint64_t index);
+    uint64_t expirations(int input_fd);
+    void end_frame();
+
+    public:
+
+    FrameScheduler(
+        std::chrono::nanoseconds tick,
+        Overrun policy = CATCH_UP,
+        size_t catch_up_limit = 5
+    );
+    ~FrameScheduler();
+
+    FrameScheduler(FrameScheduler const&) = delete;
+    FrameScheduler& operator=(FrameScheduler const&) = delete;
+
+    size_t wait(int input_fd = -1);
+    bool input_ready();
+
+    void mark(Phase phase);
+
+    int get_fd();
+    Stats stats();
+    std::string report();
+};
+
+};
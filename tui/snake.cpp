@@ -1,36 +1,34 @@
+#include <cerrno>
 #include <cmath>
-#include <thread>
 #include <queue>
 #include "tui.h"
+#include "schedule.h"
 
 struct Position {
     int x;
     int y;
 };
 
-// Updates game state information based upon key presses from the user
-void handle_input(bool *done, char *dir) {
-    while (!*done) {
-        char c = std::getchar();
-        switch (c) {
-            case 'Q': case 'q':
-                (*done) = true;
-            break;
-            case 'W': case 'w':
-                (*dir) = 'w';
-            break;
-            case 'A': case 'a':
-                (*dir) = 'a';
-            break;
-            case 'S': case 's':
-                (*dir) = 's';
-            break;
-            case 'D': case 'd':
-                (*dir) = 'd';
-            break;
-            default:
-            break;
-        }
+// Updates game state information based upon a key press from the user
+void handle_input(char c, bool *done, char *dir) {
+    switch (c) {
+        case 'Q': case 'q':
+            (*done) = true;
+        break;
+        case 'W': case 'w':
+            (*dir) = 'w';
+        break;
+        case 'A': case 'a':
+            (*dir) = 'a';
+        break;
+        case 'S': case 's':
+            (*dir) = 's';
+        break;
+        case 'D': case 'd':
+            (*dir) = 'd';
+        break;
+        default:
+        break;
     }
 }
 
@@ -64,8 +62,9 @@ int main() {
     char last_dir = 'd';
     char dir = 'd';
 
-    // Start up helper thread that handles the effects of user input
-    std::thread input_handler(handle_input,&done,&dir);
+    // Tick at a fixed rate that is slow enough for humans to play,
+    // waking up early whenever the user presses a key
+    TUI::FrameScheduler scheduler(std::chrono::milliseconds(50));
 
     // Initialize the food to be at a random location in the world
     Position food = {rand()%WIDTH, rand()%HEIGHT};
@@ -90,68 +89,86 @@ int main() {
     // Keep going until we are done
     while (!done) {
 
-        // Throttle framerate to make the program slow enough for
-        // humans to play
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-
-        // Prevent snake from doubling back on itself
-        switch (last_dir) {
-            case 'w': if (dir == 's') {dir = 'w';} break;
-            case 'a': if (dir == 'd') {dir = 'a';} break;
-            case 's': if (dir == 'w') {dir = 's';} break;
-            case 'd': if (dir == 'a') {dir = 'd';} break;
-            default: break;
-        }
+        size_t ticks = scheduler.wait(STDIN_FILENO);
 
-        // Move snake in its current direction of travel
-        switch (dir) {
-            case 'w': pos.y = (pos.y+HEIGHT-1) % HEIGHT;  break;
-            case 'a': pos.x = (pos.x+WIDTH-1) % WIDTH;    break;
-            case 's': pos.y = (pos.y+1) % HEIGHT;         break;
-            case 'd': pos.x = (pos.x+1) % WIDTH;          break;
-            default: break;
+        // Handle any key presses
+        if (scheduler.input_ready()) {
+            char c;
+            if (read(STDIN_FILENO,&c,1) == 1) {
+                handle_input(c,&done,&dir);
+            }
         }
 
-        // Remember the most recent direction of movement
-        last_dir = dir;
+        // Advance the game once per tick that has come due
+        for (size_t tick=0; (tick<ticks) && !done; tick++) {
 
-        // Hide last segment of snake tail and remove it from body queue
-        if ( (pos.x == food.x) && (pos.y == food.y) ){
-            food = {rand()%WIDTH, rand()%HEIGHT};
-            canvas(food.x*2,  food.y) = TUI::Tile{
-                "🍎",
-                TUI::RGB{0,0,0},
+            // Prevent snake from doubling back on itself
+            switch (last_dir) {
+                case 'w': if (dir == 's') {dir = 'w';} break;
+                case 'a': if (dir == 'd') {dir = 'a';} break;
+                case 's': if (dir == 'w') {dir = 's';} break;
+                case 'd': if (dir == 'a') {dir = 'd';} break;
+                default: break;
+            }
+
+            // Move snake in its current direction of travel
+            switch (dir) {
+                case 'w': pos.y = (pos.y+HEIGHT-1) % HEIGHT;  break;
+                case 'a': pos.x = (pos.x+WIDTH-1) % WIDTH;    break;
+                case 's': pos.y = (pos.y+1) % HEIGHT;         break;
+                case 'd': pos.x = (pos.x+1) % WIDTH;          break;
+                default: break;
+            }
+
+            // Remember the most recent direction of movement
+            last_dir = dir;
+
+            // Hide last segment of snake tail and remove it from body queue
+            if ( (pos.x == food.x) && (pos.y == food.y) ){
+                food = {rand()%WIDTH, rand()%HEIGHT};
+                canvas(food.x*2,  food.y) = TUI::Tile{
+                    "🍎",
+                    TUI::RGB{0,0,0},
+                    TUI::RGB{0,0,0},
+                };
+                canvas.reposition(rand()%10,rand()%10);
+            } else {
+                Position tail_pos = snake_body.front();
+                canvas(tail_pos.x*2,  tail_pos.y) = TUI::Tile{TUI::RGB{0,0,0}};
+                canvas(tail_pos.x*2+1,tail_pos.y) = TUI::Tile{TUI::RGB{0,0,0}};
+                snake_body.pop_front();
+            }
+
+            // Add new segment of snake to the front of the body queue and
+            // write it to the canvas
+            snake_body.push_back(pos);
+            canvas(pos.x*2,  pos.y) = TUI::Tile{
+                "🟩",
                 TUI::RGB{0,0,0},
+                TUI::RGB{0,0,0}
             };
-            canvas.reposition(rand()%10,rand()%10);
-        } else {
-            Position tail_pos = snake_body.front();
-            canvas(tail_pos.x*2,  tail_pos.y) = TUI::Tile{TUI::RGB{0,0,0}};
-            canvas(tail_pos.x*2+1,tail_pos.y) = TUI::Tile{TUI::RGB{0,0,0}};
-            snake_body.pop_front();
-        }
 
-        // Add new segment of snake to the front of the body queue and
-        // write it to the canvas
-        snake_body.push_back(pos);
-        canvas(pos.x*2,  pos.y) = TUI::Tile{
-            "🟩",
-            TUI::RGB{0,0,0},
-            TUI::RGB{0,0,0}
-        };
 
-
-        // Check for snake self-collisions and trigger break if one is found
-        size_t length = snake_body.size();
-        for (size_t i=0; i<(length-1); i++) {
-            if ((snake_body[i].x == pos.x) && (snake_body[i].y == pos.y)) {
-                done = true;
-                lost = true;
+            // Check for snake self-collisions and trigger break if one is found
+            size_t length = snake_body.size();
+            for (size_t i=0; i<(length-1); i++) {
+                if ((snake_body[i].x == pos.x) && (snake_body[i].y == pos.y)) {
+                    done = true;
+                    lost = true;
+                }
             }
         }
-
-        // Update changed portions of the canvas
-        canvas.lazy_display();
+        scheduler.mark(TUI::FrameScheduler::LOGIC);
+
+        // Update changed portions of the canvas, but only if the game
+        // actually moved
+        if (ticks > 0) {
+            std::string output = canvas.lazy_render();
+            scheduler.mark(TUI::FrameScheduler::ENCODE);
+            std::cout << output;
+            std::cout.flush();
+            scheduler.mark(TUI::FrameScheduler::WRITE);
+        }
     }
 
     // Display game over screen if the player lost
@@ -185,10 +202,11 @@ int main() {
 
         // Again, update the display
         canvas.lazy_display();
-    }
 
-    // Wait for the input handler to finish up
-    input_handler.join();
+        // Leave the game over screen up until the user presses a key
+        char c;
+        while ( (read(STDIN_FILENO,&c,1) == -1) && (errno == EINTR) ) {}
+    }
 
     // Make sure the terminal has been restored to cooked mode, then
     // hide the canvas
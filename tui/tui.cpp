@@ -54,40 +54,156 @@ std::string Tile::raw_symbol() {
 }
 
 
+std::vector<TilePool::Block> TilePool::free_blocks;
+
+// Returns an array of at least `count` tiles, writing the actual size of
+// the array to `capacity`. Reuses the smallest released array that fits,
+// as long as it isn't wastefully large, and otherwise allocates a new
+// array with headroom so that modest growth won't need another one.
+Tile* TilePool::acquire(size_t count, size_t &capacity) {
+    size_t best = free_blocks.size();
+    for (size_t i=0; i<free_blocks.size(); i++) {
+        size_t block_capacity = free_blocks[i].capacity;
+        if ( (block_capacity < count) || (block_capacity > count*4+64) ) {
+            continue;
+        }
+        if ( (best == free_blocks.size()) || (block_capacity < free_blocks[best].capacity) ) {
+            best = i;
+        }
+    }
+    if (best != free_blocks.size()) {
+        Tile *tiles = free_blocks[best].tiles.release();
+        capacity    = free_blocks[best].capacity;
+        free_blocks.erase(free_blocks.begin()+best);
+        return tiles;
+    }
+    capacity = count + count/2 + 16;
+    return new Tile[capacity];
+}
+
+// Hands an array back to the pool. Released tiles are reset lazily, by
+// whichever canvas acquires the array next.
+void TilePool::release(Tile *tiles, size_t capacity) {
+    if (tiles == nullptr) {
+        return;
+    }
+    free_blocks.push_back(Block{std::unique_ptr<Tile[]>(tiles),capacity});
+    if (free_blocks.size() > FREE_LIMIT) {
+        free_blocks.erase(free_blocks.begin());
+    }
+}
+
+// Frees every array held by the pool
+void TilePool::trim() {
+    free_blocks.clear();
+}
+
+
 Canvas::Canvas(size_t width, size_t height, size_t x, size_t y)
     : width(width)
     , height(height)
+    , prev_capacity(0)
+    , tile_capacity(0)
     , offset_x(x)
     , offset_y(y)
-    , prev_buffer(new Tile[height*width])
-    , tile_buffer(new Tile[height*width])
-{}
+    , prev_buffer(nullptr)
+    , tile_buffer(nullptr)
+{
+    prev_buffer = TilePool::acquire(width*height,prev_capacity);
+    tile_buffer = TilePool::acquire(width*height,tile_capacity);
+    std::fill(prev_buffer,prev_buffer+width*height,Tile());
+    std::fill(tile_buffer,tile_buffer+width*height,Tile());
+}
 
 
 Canvas::Canvas(size_t width, size_t height)
-    : width(width)
-    , height(height)
-    , offset_x(0)
-    , offset_y(0)
-    , prev_buffer(new Tile[height*width])
-    , tile_buffer(new Tile[height*width])
+    : Canvas(width,height,0,0)
 {}
 
-void Canvas::resize(size_t width, size_t height) {
-    Tile *new_tile_buffer = new Tile[height*width];
-    Tile *new_prev_buffer = new Tile[height*width];
-    size_t x_limit = std::min(this->width,width);
-    size_t y_limit = std::min(this->width,width);
-    for (size_t y=0; y<y_limit; y++) {
-        for (size_t x=0; x<x_limit; x++) {
-            new_tile_buffer[y*width+x] = (*this)(x,y);
-            new_prev_buffer[y*width+x] = (*this)(x,y);
+
+Canvas::~Canvas() {
+    TilePool::release(tile_buffer,tile_capacity);
+    TilePool::release(prev_buffer,prev_capacity);
+}
+
+
+// Moves the rows of a `old_width` by `old_height` image in `from` into a
+// `new_width` by `new_height` layout in `to`, clearing any tiles that the
+// old image didn't cover. `from` and `to` may be the same array, so rows
+// are moved in whichever order avoids overwriting rows yet to be moved.
+void Canvas::relayout(
+    Tile *from, Tile *to,
+    size_t old_width, size_t old_height,
+    size_t new_width, size_t new_height
+) {
+    size_t x_limit = std::min(old_width, new_width);
+    size_t y_limit = std::min(old_height,new_height);
+    if ( (from != to) || (new_width <= old_width) ) {
+        // Rows only ever move towards the front of the array
+        for (size_t y=0; y<y_limit; y++) {
+            Tile *src = from + y*old_width;
+            Tile *dst = to   + y*new_width;
+            if (src != dst) {
+                std::move(src,src+x_limit,dst);
+            }
+        }
+    } else {
+        // Rows only ever move towards the back of the array
+        for (size_t y=y_limit; y-- > 0; ) {
+            Tile *src = from + y*old_width;
+            Tile *dst = to   + y*new_width;
+            if (src != dst) {
+                std::move_backward(src,src+x_limit,dst+x_limit);
+            }
+        }
+    }
+    // Clear whatever the old image didn't cover
+    if (new_width > x_limit) {
+        for (size_t y=0; y<y_limit; y++) {
+            Tile *row = to + y*new_width;
+            std::fill(row+x_limit,row+new_width,Tile());
         }
     }
-    delete[] tile_buffer;
-    delete[] prev_buffer;
-    tile_buffer = new_tile_buffer;
-    prev_buffer = new_prev_buffer;
+    std::fill(to+y_limit*new_width,to+new_height*new_width,Tile());
+}
+
+
+// Lays a buffer out for the new dimensions, in place if it has the
+// capacity, and otherwise in a new array from the pool
+void Canvas::resize_buffer(
+    Tile *&buffer, size_t &capacity,
+    size_t old_width, size_t old_height,
+    size_t new_width, size_t new_height
+) {
+    size_t count = new_width*new_height;
+    if (count <= capacity) {
+        relayout(buffer,buffer,old_width,old_height,new_width,new_height);
+        return;
+    }
+    size_t new_capacity;
+    Tile *new_buffer = TilePool::acquire(count,new_capacity);
+    relayout(buffer,new_buffer,old_width,old_height,new_width,new_height);
+    TilePool::release(buffer,capacity);
+    buffer   = new_buffer;
+    capacity = new_capacity;
+}
+
+
+// Resizing keeps the overlapping portion of the image. As long as the new
+// size fits in the canvas' capacity, no allocation takes place.
+void Canvas::resize(size_t width, size_t height) {
+    resize_buffer(tile_buffer,tile_capacity,this->width,this->height,width,height);
+    resize_buffer(prev_buffer,prev_capacity,this->width,this->height,width,height);
+    this->width  = width;
+    this->height = height;
+}
+
+// Clears the canvas from the terminal, resizes it, and then redraws it.
+// Intended for reacting to terminal size changes (see `Input::resized`).
+void Canvas::refit(size_t width, size_t height) {
+    hide();
+    resize(width,height);
+    full_display();
 }
 
 void Canvas::reposition(size_t x, size_t y) {
@@ -135,6 +251,12 @@ void Canvas::hide() {
 
 // Draw the entire canvas to the terminal
 void Canvas::full_display() {
+    std::cout << full_render();
+}
+
+
+// Returns the output that `full_display` writes to the terminal
+std::string Canvas::full_render() {
     std::string output;
     Tile *last_tile = nullptr;
     output += "\033[s";
@@ -154,6 +276,9 @@ void Canvas::full_display() {
             if (last_tile != nullptr) {
                 mismatch |= last_tile->fore_color != current_tile.fore_color;
                 mismatch |= last_tile->back_color != current_tile.back_color;
+                // Spaces don't set the foreground color, so the terminal's
+                // foreground can't be trusted after one
+                mismatch |= (last_tile->symbol == " ") && (current_tile.symbol != " ");
             }
             last_tile = &current_tile;
             // Write out tile, avoiding escapes if they aren't necessary
@@ -171,7 +296,7 @@ void Canvas::full_display() {
         output += "\r\n";
     }
     output += "\033[u";
-    std::cout << output;
+    return output;
 }
 
 
@@ -179,6 +304,14 @@ void Canvas::full_display() {
 // have changed, but it requires `full_display` to be called once after
 // the canvas is constructed or resized.
 void Canvas::lazy_display() {
+    std::cout << lazy_render();
+    std::cout.flush();
+}
+
+
+// Returns the output that `lazy_display` writes to the terminal. Like
+// `lazy_display`, this marks the changed tiles as displayed.
+std::string Canvas::lazy_render() {
     std::string output;
     Tile *last_tile = nullptr;
 
@@ -241,6 +374,9 @@ void Canvas::lazy_display() {
                 if (last_tile != nullptr) {
                     mismatch |= last_tile->fore_color != next_state.fore_color;
                     mismatch |= last_tile->back_color != next_state.back_color;
+                    // Spaces don't set the foreground color, so the terminal's
+                    // foreground can't be trusted after one
+                    mismatch |= (last_tile->symbol == " ") && (next_state.symbol != " ");
                 }
                 first = false;
 
@@ -265,8 +401,7 @@ void Canvas::lazy_display() {
     output += "\033[u";
     // Set the foreground and background colors back to their defaults, just in case
     output += "\033[39m\033[49m";
-    std::cout << output;
-    std::cout.flush();
+    return output;
 }
 
 size_t Canvas::get_width() {
@@ -277,6 +412,14 @@ size_t Canvas::get_height() {
     return height;
 }
 
+size_t Canvas::get_offset_x() {
+    return offset_x;
+}
+
+size_t Canvas::get_offset_y() {
+    return offset_y;
+}
+
 
 
 // Adapted from the interesting tutorial at:
@@ -314,4 +457,58 @@ void Input::raw_mode() {
     tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw_termios);
 }
 
+void Input::on_resize(int signal) {
+    // Only async-signal-safe work is allowed here, so just record that
+    // a resize happened and let `resized` deal with it later
+    resize_count++;
+}
+
+// Installs a SIGWINCH handler so that `resized` can report terminal size
+// changes
+void Input::watch_resize() {
+    struct sigaction action = {};
+    action.sa_handler = Input::on_resize;
+    sigemptyset(&action.sa_mask);
+    // Don't let resizes interrupt blocking reads of user input
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH,&action,nullptr);
+}
+
+// Writes the terminal's current dimensions, in columns and rows
+void Input::terminal_size(size_t &width, size_t &height) {
+    winsize size = {};
+    if ( (ioctl(STDOUT_FILENO,TIOCGWINSZ,&size) == -1) || (size.ws_col == 0) ) {
+        // Fall back to the classic dimensions if the terminal won't say
+        size.ws_col = 80;
+        size.ws_row = 24;
+    }
+    width  = size.ws_col;
+    height = size.ws_row;
+}
+
+// Meant to be polled from the main loop after calling `watch_resize`.
+// Returns true, and writes the new terminal dimensions, once the terminal
+// has changed size and then stayed put for at least `settle`. Dragging a
+// window edge produces a burst of signals, and this keeps that burst from
+// turning into a burst of resizes and repaints.
+bool Input::resized(size_t &width, size_t &height, std::chrono::milliseconds settle) {
+    unsigned count = resize_count.load();
+    auto now = std::chrono::steady_clock::now();
+    if (count != seen_resize_count) {
+        seen_resize_count = count;
+        seen_resize_time  = now;
+        return false;
+    }
+    if ( (count == handled_resize_count) || (now - seen_resize_time < settle) ) {
+        return false;
+    }
+    handled_resize_count = count;
+    terminal_size(width,height);
+    return true;
+}
+
 termios Input::original_termios;
+std::atomic<unsigned> Input::resize_count(0);
+unsigned Input::seen_resize_count    = 0;
+unsigned Input::handled_resize_count = 0;
+std::chrono::steady_clock::time_point Input::seen_resize_time;
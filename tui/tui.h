@@ -1,7 +1,14 @@
+#pragma once
+
+#include <algorithm>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <sstream>
 #include <atomic>
+#include <chrono>
+#include <vector>
+#include <sys/ioctl.h>
 #include <sys/signal.h>
 #include <termios.h>
 #include <unistd.h>
@@ -45,12 +52,42 @@ struct Tile {
 };
 
 
+// Hands out Tile arrays with some capacity headroom and holds on to
+// released arrays so they can be handed out again, meaning canvases that
+// grow, shrink, or get recreated don't keep going back to the allocator.
+// Not thread safe; canvases are expected to be managed from one thread.
+class TilePool {
+
+    struct Block {
+        std::unique_ptr<Tile[]> tiles;
+        size_t capacity;
+    };
+
+    // Released arrays waiting to be reused, oldest first. The pool owns
+    // these, so whatever is left in it is freed at exit.
+    static std::vector<Block> free_blocks;
+
+    // How many released arrays are kept before the oldest are freed
+    static size_t const FREE_LIMIT = 8;
+
+    public:
+
+    static Tile* acquire(size_t count, size_t &capacity);
+    static void  release(Tile *tiles, size_t capacity);
+    static void  trim();
+};
+
+
 class Canvas {
 
     // Dimensions
     size_t width;
     size_t height;
 
+    // Number of tiles each buffer can hold without reallocation
+    size_t prev_capacity;
+    size_t tile_capacity;
+
     // Offset
     size_t offset_x;
     size_t offset_y;
@@ -62,12 +99,29 @@ class Canvas {
     // output the next time a display occurs
     Tile *tile_buffer;
 
+    static void relayout(
+        Tile *from, Tile *to,
+        size_t old_width, size_t old_height,
+        size_t new_width, size_t new_height
+    );
+    static void resize_buffer(
+        Tile *&buffer, size_t &capacity,
+        size_t old_width, size_t old_height,
+        size_t new_width, size_t new_height
+    );
+
 
     public:
     Canvas(size_t width, size_t height, size_t x, size_t y);
     Canvas(size_t width, size_t height);
+    ~Canvas();
+
+    // Canvases own their buffers, so they shouldn't be copied around
+    Canvas(Canvas const&) = delete;
+    Canvas& operator=(Canvas const&) = delete;
 
     void resize(size_t width, size_t height);
+    void refit(size_t width, size_t height);
     void reposition(size_t x, size_t y);
     Tile& operator()(size_t x, size_t y);
 
@@ -75,8 +129,13 @@ class Canvas {
     void full_display();
     void lazy_display();
 
+    std::string full_render();
+    std::string lazy_render();
+
     size_t get_width();
     size_t get_height();
+    size_t get_offset_x();
+    size_t get_offset_y();
 };
 
 
@@ -114,11 +173,29 @@ class Input {
     // Stores the user's default settings, for later resoration
     static termios original_termios;
 
+    // Bumped by the SIGWINCH handler every time the terminal changes size
+    static std::atomic<unsigned> resize_count;
+
+    // The last resize count observed by `resized`, when it was observed,
+    // and the last count that `resized` actually reported
+    static unsigned seen_resize_count;
+    static unsigned handled_resize_count;
+    static std::chrono::steady_clock::time_point seen_resize_time;
+
+    static void on_resize(int signal);
+
     public:
 
     static void cooked_mode();
     static void last_meal(int signal);
     static void raw_mode();
+
+    static void watch_resize();
+    static void terminal_size(size_t &width, size_t &height);
+    static bool resized(
+        size_t &width, size_t &height,
+        std::chrono::milliseconds settle = std::chrono::milliseconds(50)
+    );
 };
 
 
@@ -0,0 +1,64 @@
+#include <csignal>
+#include <cstring>
+#include "blit.h"
+
+// Plays a stream of PPM frames to the terminal, for example:
+//     ffmpeg -i video.mp4 -f image2pipe -vcodec ppm - | ./view --half
+//     ./view --half frames.ppm
+// Frames are read from stdin unless a file is given.
+
+// Canvases find their origin by saving and restoring the cursor, so they
+// have to start from a known position. The video plays on the alternate
+// screen with the cursor homed and the screen cleared.
+std::string const ENTER_SCREEN = "\033[?1049h\033[H\033[2J";
+std::string const CLEAR_SCREEN = "\033[H\033[2J";
+std::string const LEAVE_SCREEN = "\033[39m\033[49m\033[?1049l";
+
+// Restores the normal screen if playback is interrupted
+void leave_screen(int signal) {
+    ssize_t ignored = write(STDOUT_FILENO,LEAVE_SCREEN.data(),LEAVE_SCREEN.size());
+    (void) ignored;
+    _exit(1);
+}
+
+int main(int argc, char **argv) {
+    bool half_block = false;
+    char const *path = nullptr;
+    for (int i=1; i<argc; i++) {
+        if (strcmp(argv[i],"--half") == 0) {
+            half_block = true;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    TUI::FrameReader *reader = (path == nullptr)
+        ? new TUI::FrameReader(STDIN_FILENO)
+        : new TUI::FrameReader(std::string(path));
+    TUI::Blitter blitter(half_block);
+
+    // Leave the last row free, since displaying a canvas ends each of its
+    // rows with a newline, which would scroll the screen on the last row
+    size_t width, height;
+    TUI::Input::terminal_size(width,height);
+    TUI::Canvas canvas(width,height-1);
+    TUI::Input::watch_resize();
+    signal(SIGINT, leave_screen);
+    signal(SIGTERM,leave_screen);
+
+    std::cout << ENTER_SCREEN;
+    canvas.full_display();
+    while (reader->next()) {
+        if (TUI::Input::resized(width,height)) {
+            // The terminal may have moved the cursor while resizing
+            std::cout << CLEAR_SCREEN;
+            canvas.refit(width,height-1);
+        }
+        blitter.blit(*reader,canvas);
+        canvas.lazy_display();
+    }
+
+    delete reader;
+    std::cout << LEAVE_SCREEN;
+    std::cout.flush();
+}
@@ -0,0 +1,446 @@
+#include "vt.h"
+
+using namespace TUI;
+
+
+VirtualTerminal::VirtualTerminal(size_t width, size_t height)
+    : width(width)
+    , height(height)
+    , cursor_x(0)
+    , cursor_y(0)
+    , saved_x(0)
+    , saved_y(0)
+    , fore_color({0,0,0})
+    , back_color({0,0,0})
+    , default_fore(true)
+    , default_back(true)
+    , tally({0,0,0,0,0,0})
+{
+    cells.assign(width*height,blank_cell());
+}
+
+
+// An empty cell, painted with the current background color, as a real
+// terminal does when it erases or scrolls in new lines
+VirtualTerminal::Cell VirtualTerminal::blank_cell() {
+    return Cell{" ",{0,0,0},back_color,true,default_back,false};
+}
+
+
+// Moves the cursor down a line, scrolling the screen up if it is already
+// on the bottom line
+void VirtualTerminal::line_feed() {
+    if (cursor_y+1 < height) {
+        cursor_y++;
+        return;
+    }
+    std::move(cells.begin()+width,cells.end(),cells.begin());
+    std::fill(cells.end()-width,cells.end(),blank_cell());
+}
+
+
+// Clears the cells in [start,end) on row y
+void VirtualTerminal::erase(size_t y, size_t start, size_t end) {
+    end = std::min(end,width);
+    for (size_t x=start; x<end; x++) {
+        cells[y*width+x] = blank_cell();
+    }
+}
+
+
+// Writes a symbol at the cursor, handling double-width symbols the way
+// terminals do: the symbol covers the cell to its right, and overwriting
+// either half of a double-width symbol turns the other half into a space
+// that keeps the symbol's colors.
+void VirtualTerminal::put_symbol(std::string const& symbol) {
+    tally.symbols++;
+    size_t symbol_columns = symbol_width(symbol);
+
+    // Zero width symbols (eg: variation selectors) attach to the
+    // previously written cell
+    if (symbol_columns == 0) {
+        if (cursor_x > 0) {
+            size_t x = cursor_x-1;
+            if (cells[cursor_y*width+x].continuation && (x > 0)) {
+                x--;
+            }
+            cells[cursor_y*width+x].symbol += symbol;
+        }
+        return;
+    }
+
+    // Wrap once the cursor has run off the right edge
+    if (cursor_x+symbol_columns > width) {
+        cursor_x = 0;
+        line_feed();
+    }
+
+    Cell *row = &cells[cursor_y*width];
+    for (size_t x=cursor_x; x<cursor_x+symbol_columns; x++) {
+        if (row[x].continuation && (x > 0)) {
+            row[x-1].symbol = " ";
+        }
+        if ( (x+1 < width) && row[x+1].continuation ) {
+            row[x+1].symbol = " ";
+            row[x+1].continuation = false;
+        }
+    }
+
+    row[cursor_x] = Cell{symbol,fore_color,back_color,default_fore,default_back,false};
+    for (size_t x=1; x<symbol_columns; x++) {
+        row[cursor_x+x] = Cell{"",fore_color,back_color,default_fore,default_back,true};
+    }
+    cursor_x += symbol_columns;
+}
+
+
+void VirtualTerminal::select_graphic_rendition(std::vector<int> const& params) {
+    tally.color_escapes++;
+    if (params.empty()) {
+        default_fore = true;
+        default_back = true;
+        return;
+    }
+    for (size_t i=0; i<params.size(); i++) {
+        int param = params[i];
+        if (param == 0) {
+            default_fore = true;
+            default_back = true;
+        } else if (param == 39) {
+            default_fore = true;
+        } else if (param == 49) {
+            default_back = true;
+        } else if ( ((param == 38) || (param == 48)) && (i+4 < params.size()) && (params[i+1] == 2) ) {
+            RGB color = {
+                (uint8_t) params[i+2],
+                (uint8_t) params[i+3],
+                (uint8_t) params[i+4]
+            };
+            if (param == 38) {
+                fore_color   = color;
+                default_fore = false;
+            } else {
+                back_color   = color;
+                default_back = false;
+            }
+            i += 4;
+        } else {
+            std::stringstream ss;
+            ss << "VirtualTerminal recieved unsupported SGR parameter " << param;
+            throw std::runtime_error(ss.str());
+        }
+    }
+}
+
+
+void VirtualTerminal::control_sequence(std::string const& params, char final) {
+    tally.escapes++;
+
+    // Split the parameter string into its numeric fields, with empty
+    // fields represented by -1 so each command can apply its own default
+    std::vector<int> fields;
+    int field = -1;
+    for (char c : params) {
+        if (c == ';') {
+            fields.push_back(field);
+            field = -1;
+        } else if ( (c >= '0') && (c <= '9') ) {
+            field = ( (field < 0) ? 0 : field*10 ) + (c - '0');
+        } else {
+            std::stringstream ss;
+            ss << "VirtualTerminal recieved unsupported CSI parameters \""
+               << params << final << '"';
+            throw std::runtime_error(ss.str());
+        }
+    }
+    if ( !params.empty() ) {
+        fields.push_back(field);
+    }
+    auto arg = [&](size_t index, int fallback) -> size_t {
+        if ( (index >= fields.size()) || (fields[index] <= 0) ) {
+            return fallback;
+        }
+        return fields[index];
+    };
+
+    switch (final) {
+        case 'A':
+            tally.move_escapes++;
+            cursor_y -= std::min(cursor_y,arg(0,1));
+        break;
+        case 'B':
+            tally.move_escapes++;
+            cursor_y = std::min(cursor_y+arg(0,1),height-1);
+        break;
+        case 'C':
+            tally.move_escapes++;
+            cursor_x = std::min(cursor_x+arg(0,1),width-1);
+        break;
+        case 'D':
+            tally.move_escapes++;
+            cursor_x -= std::min(cursor_x,arg(0,1));
+        break;
+        case 'G':
+            tally.move_escapes++;
+            cursor_x = std::min(arg(0,1)-1,width-1);
+        break;
+        case 'H': case 'f':
+            tally.move_escapes++;
+            cursor_y = std::min(arg(0,1)-1,height-1);
+            cursor_x = std::min(arg(1,1)-1,width-1);
+        break;
+        case 's':
+            tally.move_escapes++;
+            saved_x = cursor_x;
+            saved_y = cursor_y;
+        break;
+        case 'u':
+            tally.move_escapes++;
+            cursor_x = saved_x;
+            cursor_y = saved_y;
+        break;
+        case 'K':
+            switch (arg(0,0)) {
+                case 0: erase(cursor_y,cursor_x,width);   break;
+                case 1: erase(cursor_y,0,cursor_x+1);     break;
+                default: erase(cursor_y,0,width);         break;
+            }
+        break;
+        case 'J':
+            switch (arg(0,0)) {
+                case 0:
+                    erase(cursor_y,cursor_x,width);
+                    for (size_t y=cursor_y+1; y<height; y++) {
+                        erase(y,0,width);
+                    }
+                break;
+                case 1:
+                    for (size_t y=0; y<cursor_y; y++) {
+                        erase(y,0,width);
+                    }
+                    erase(cursor_y,0,cursor_x+1);
+                break;
+                case 2: case 3:
+                    for (size_t y=0; y<height; y++) {
+                        erase(y,0,width);
+                    }
+                break;
+                default: {
+                    std::stringstream ss;
+                    ss << "VirtualTerminal recieved unsupported erase in display parameter "
+                       << arg(0,0);
+                    throw std::runtime_error(ss.str());
+                }
+            }
+        break;
+        case 'm': {
+            std::vector<int> sgr;
+            for (int value : fields) {
+                sgr.push_back( (value < 0) ? 0 : value );
+            }
+            select_graphic_rendition(sgr);
+        }
+        break;
+        default: {
+            std::stringstream ss;
+            ss << "VirtualTerminal recieved unsupported CSI sequence \"ESC["
+               << params << final << '"';
+            throw std::runtime_error(ss.str());
+        }
+    }
+}
+
+
+// Interprets one frame's worth of output. Sequences split across frames
+// are held until the rest of their bytes arrive.
+void VirtualTerminal::feed(std::string const& bytes) {
+    tally.frames++;
+    tally.bytes += bytes.size();
+
+    std::string input = pending + bytes;
+    pending.clear();
+
+    size_t i = 0;
+    while (i < input.size()) {
+        unsigned char c = input[i];
+
+        if (c == '\033') {
+            // Find the end of the control sequence
+            if ( (i+1 < input.size()) && (input[i+1] != '[') ) {
+                throw std::runtime_error("VirtualTerminal recieved an escape that isn't a CSI sequence");
+            }
+            size_t end = i+2;
+            while ( (end < input.size()) && ((input[end] < 0x40) || (input[end] > 0x7E)) ) {
+                end++;
+            }
+            if (end >= input.size()) {
+                pending = input.substr(i);
+                return;
+            }
+            control_sequence(input.substr(i+2,end-i-2),input[end]);
+            i = end+1;
+        } else if (c == '\r') {
+            cursor_x = 0;
+            i++;
+        } else if (c == '\n') {
+            line_feed();
+            i++;
+        } else if (c == '\b') {
+            cursor_x -= (cursor_x > 0) ? 1 : 0;
+            i++;
+        } else if (c < 0x20) {
+            // Other control characters don't affect the screen
+            i++;
+        } else {
+            // Gather up a full UTF-8 sequence
+            size_t length = 1;
+            if      ((c & 0xE0) == 0xC0) { length = 2; }
+            else if ((c & 0xF0) == 0xE0) { length = 3; }
+            else if ((c & 0xF8) == 0xF0) { length = 4; }
+            if (i+length > input.size()) {
+                pending = input.substr(i);
+                return;
+            }
+            put_symbol(input.substr(i,length));
+            i += length;
+        }
+    }
+}
+
+
+void VirtualTerminal::replay(std::vector<std::string> const& frames) {
+    for (std::string const& frame : frames) {
+        feed(frame);
+    }
+}
+
+
+VirtualTerminal::Cell& VirtualTerminal::operator()(size_t x, size_t y) {
+    if ( (x>=width) || (y>=height) ) {
+        std::stringstream ss;
+        ss << "VirtualTerminal with dimensions ("
+           << width << ',' << height
+           << ") accessed out of bounds with coordinates ("
+           << x << ',' << y << ')';
+        throw std::runtime_error(ss.str());
+    }
+    return cells[y*width+x];
+}
+
+
+// Compares the screen against the tiles of a canvas, which is assumed to
+// have been drawn with the cursor starting on row `origin_y`. Returns a
+// description of the first mismatch, or an empty string if none is found.
+//
+// Tiles with an empty symbol don't draw anything, so the cells under them
+// aren't checked. The cells covered by the right half of a double-width
+// symbol aren't checked either, and neither are the foreground colors of
+// spaces, since they aren't visible.
+std::string VirtualTerminal::diff(Canvas &canvas, size_t origin_y) {
+    size_t offset_x = canvas.get_offset_x();
+    size_t offset_y = canvas.get_offset_y() + origin_y;
+    size_t canvas_width  = canvas.get_width();
+    size_t canvas_height = canvas.get_height();
+
+    for (size_t y=0; y<canvas_height; y++) {
+        for (size_t x=0; x<canvas_width; x++) {
+            Tile &tile = canvas(x,y);
+            size_t screen_x = offset_x + x;
+            size_t screen_y = offset_y + y;
+            if ( (screen_x >= width) || (screen_y >= height) ) {
+                continue;
+            }
+            if (tile.symbol.empty()) {
+                continue;
+            }
+            Cell &cell = cells[screen_y*width+screen_x];
+
+            std::string problem;
+            if (cell.symbol != tile.symbol) {
+                problem = "symbol \"" + cell.symbol + "\" instead of \"" + tile.symbol + "\"";
+            } else if (cell.default_back || (cell.back_color != tile.back_color)) {
+                problem = "the wrong background color";
+            } else if ( (tile.symbol != " ")
+                    && (cell.default_fore || (cell.fore_color != tile.fore_color)) ) {
+                problem = "the wrong foreground color";
+            }
+            if ( !problem.empty() ) {
+                std::stringstream ss;
+                ss << "Tile (" << x << ',' << y << ") displayed at ("
+                   << screen_x << ',' << screen_y << ") with " << problem;
+                return ss.str();
+            }
+
+            // Skip over the cells covered by a wide symbol
+            x += symbol_width(tile.symbol) - 1;
+        }
+    }
+    return "";
+}
+
+
+// Like `diff`, but throws if the screen doesn't match the canvas
+void VirtualTerminal::verify(Canvas &canvas, size_t origin_y) {
+    std::string problem = diff(canvas,origin_y);
+    if ( !problem.empty() ) {
+        throw std::runtime_error(problem);
+    }
+}
+
+
+VirtualTerminal::Score VirtualTerminal::score() {
+    return tally;
+}
+
+void VirtualTerminal::reset_score() {
+    tally = Score{0,0,0,0,0,0};
+}
+
+size_t VirtualTerminal::get_width() {
+    return width;
+}
+
+size_t VirtualTerminal::get_height() {
+    return height;
+}
+
+
+// Returns how many columns a terminal would give the first codepoint of
+// a UTF-8 encoded symbol. This only covers the common wide ranges (CJK and
+// emoji), which is all the programs using this library draw.
+size_t VirtualTerminal::symbol_width(std::string const& symbol) {
+    if (symbol.empty()) {
+        return 1;
+    }
+    unsigned char lead = symbol[0];
+    uint32_t code;
+    size_t length;
+    if      (lead < 0x80)           { code = lead;        length = 1; }
+    else if ((lead & 0xE0) == 0xC0) { code = lead & 0x1F; length = 2; }
+    else if ((lead & 0xF0) == 0xE0) { code = lead & 0x0F; length = 3; }
+    else                            { code = lead & 0x07; length = 4; }
+    for (size_t i=1; (i<length) && (i<symbol.size()); i++) {
+        code = (code << 6) | (symbol[i] & 0x3F);
+    }
+
+    // Combining marks, zero width joiners, and variation selectors
+    if (    ((code >= 0x0300) && (code <= 0x036F))
+         || ((code >= 0x200B) && (code <= 0x200F))
+         || ((code >= 0xFE00) && (code <= 0xFE0F)) ) {
+        return 0;
+    }
+
+    bool wide =    ((code >= 0x1100 ) && (code <= 0x115F ))
+                || ((code >= 0x2E80 ) && (code <= 0xA4CF ))
+                || ((code >= 0xAC00 ) && (code <= 0xD7A3 ))
+                || ((code >= 0xF900 ) && (code <= 0xFAFF ))
+                || ((code >= 0xFE30 ) && (code <= 0xFE4F ))
+                || ((code >= 0xFF00 ) && (code <= 0xFF60 ))
+                || ((code >= 0xFFE0 ) && (code <= 0xFFE6 ))
+                || ((code >= 0x1F300) && (code <= 0x1F64F))
+                || ((code >= 0x1F680) && (code <= 0x1F6FF))
+                || ((code >= 0x1F7E0) && (code <= 0x1F7EB))
+                || ((code >= 0x1F900) && (code <= 0x1F9FF))
+                || ((code >= 0x20000) && (code <= 0x3FFFD));
+    return wide ? 2 : 1;
+}
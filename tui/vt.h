@@ -0,0 +1,107 @@
+#pragma once
+
+#include "tui.h"
+
+namespace TUI {
+
+// A minimal model of a terminal screen, understanding the subset of
+// control characters and CSI sequences that Canvas emits. Output captured
+// from a canvas can be fed through it to check that what lands on screen
+// matches the canvas' tiles, and to count what it cost to get it there.
+class VirtualTerminal {
+
+    public:
+
+    // A single character cell on the modeled screen
+    struct Cell {
+        std::string symbol;
+        RGB fore_color;
+        RGB back_color;
+
+        // Whether the colors were left at the terminal's defaults
+        bool default_fore;
+        bool default_back;
+
+        // Whether this cell is the right half of a double-width symbol
+        bool continuation;
+    };
+
+    // Tallies of the output fed to the terminal so far
+    struct Score {
+        size_t frames;
+        size_t bytes;
+        size_t escapes;
+        size_t color_escapes;
+        size_t move_escapes;
+        size_t symbols;
+    };
+
+    private:
+
+    size_t width;
+    size_t height;
+    std::vector<Cell> cells;
+
+    // Cursor state
+    size_t cursor_x;
+    size_t cursor_y;
+    size_t saved_x;
+    size_t saved_y;
+
+    // Graphic rendition state
+    RGB  fore_color;
+    RGB  back_color;
+    bool default_fore;
+    bool default_back;
+
+    // Bytes from an incomplete escape or UTF-8 sequence, held until
+    // the rest arrives in a later frame
+    std::string pending;
+
+    Score tally;
+
+    Cell blank_cell();
+    void line_feed();
+    void put_symbol(std::string const& symbol);
+    void erase(size_t y, size_t start, size_t end);
+    void control_sequence(std::string const& params, char final);
+    void select_graphic_rendition(std::vector<int> const& params);
+
+    public:
+
+    VirtualTerminal(size_t width, size_t height);
+
+    void feed(std::string const& bytes);
+    void replay(std::vector<std::string> const& frames);
+
+    Cell& operator()(size_t x, size_t y);
+
+    std::string diff(Canvas &canvas, size_t origin_y = 0);
+    void verify(Canvas &canvas, size_t origin_y = 0);
+
+    Score score();
+    void reset_score();
+
+    size_t get_width();
+    size_t get_height();
+
+    static size_t symbol_width(std::string const& symbol);
+
+    // Runs `draw` and returns everything it wrote to std::cout, rather
+    // than letting it reach the real terminal
+    template<typename F>
+    static std::string capture(F draw) {
+        std::stringstream captured;
+        std::streambuf *original = std::cout.rdbuf(captured.rdbuf());
+        try {
+            draw();
+        } catch (...) {
+            std::cout.rdbuf(original);
+            throw;
+        }
+        std::cout.rdbuf(original);
+        return captured.str();
+    }
+};
+
+};
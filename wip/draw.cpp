@@ -1,6 +1,7 @@
 #include "tui.h"
+#include "schedule.h"
 #include <cmath>
-#include <thread>
+#include <cstring>
 
 struct Vec3 {
     float x, y, z;
@@ -28,22 +29,130 @@ struct Ray {
     Vec3 direction;
 };
 
+// Counts of the work done while rendering
+struct MarchStats {
+    size_t rays;
+    size_t steps;
+    size_t evaluations;
+    size_t hits;
+};
+
 struct RenderConfig {
     float(*distance)(Ray);
     TUI::RGB(*color)(Ray);
     float min_dist;
     size_t step_limit;
+
+    // Rays that travel further than this count as misses
+    float max_dist = INFINITY;
+
+    // Settings for `sphere_trace`, which is used instead of `march` when
+    // `enhanced` is set. A relaxation of 1 disables over-relaxation. The
+    // adaptive min_dist grows with distance, but never past
+    // `adaptive_limit` times `min_dist`.
+    bool  enhanced   = false;
+    float relaxation = 1.6;
+    bool  adaptive_min_dist = false;
+    float adaptive_limit = 2;
+
+    MarchStats *stats = nullptr;
 };
 
-TUI::RGB march(Ray ray, RenderConfig config) {
+// Evaluates the distance field, counting the evaluation
+float evaluate(Vec3 position, RenderConfig const& config) {
+    if (config.stats != nullptr) {
+        config.stats->evaluations++;
+    }
+    return config.distance({position,{0,0,0}});
+}
+
+TUI::RGB march(Ray ray, RenderConfig config, bool *hit_out = nullptr) {
     size_t step = 0;
-    float dist = config.distance(ray);
-    while( (dist > config.min_dist) && (step < config.step_limit) ) { 
+    float travelled = 0;
+    float dist = evaluate(ray.position,config);
+    while( (dist > config.min_dist) && (step < config.step_limit) && (travelled <= config.max_dist) ) { 
         ray.position = ray.position + ray.direction * dist * 0.5;
-        dist = config.distance(ray);
+        travelled += dist * 0.5;
+        dist = evaluate(ray.position,config);
         step++;
     }
-    if( dist <= config.min_dist) {
+    bool hit = (dist <= config.min_dist) && (travelled <= config.max_dist);
+    if (config.stats != nullptr) {
+        config.stats->rays++;
+        config.stats->steps += step;
+        config.stats->hits  += hit;
+    }
+    if (hit_out != nullptr) {
+        *hit_out = hit;
+    }
+    if (hit) {
+        return config.color(ray);
+    } else {
+        return TUI::RGB{0,0,0};
+    }
+}
+
+
+// Sphere tracing with over-relaxation (Keinert et al., "Enhanced Sphere
+// Tracing"). Steps are stretched by `relaxation`, which is only safe while
+// the unbounding spheres of consecutive steps overlap; when they don't, the
+// step is retaken without relaxation. This relies on `distance` never
+// overestimating, so unlike `march` it steps the full distance.
+//
+// With `adaptive_min_dist`, rays also stop once they come within
+// `footprint` times their distance from the camera, roughly the radius of
+// their pixel. That radius is capped, and rays past `max_dist` miss, but
+// rays that graze a surface can still stop short and count as hits, so
+// this is off by default: in `--bench` it saves about one step per pixel
+// and changes whether about 3% of pixels hit anything.
+TUI::RGB sphere_trace(Ray ray, RenderConfig config, float footprint, bool *hit_out = nullptr) {
+    float omega       = config.relaxation;
+    float t           = 0;
+    float step_length = 0;
+    float prev_radius = 0;
+    float radius      = 0;
+    bool  hit         = false;
+    size_t step = 0;
+    for (; (step < config.step_limit) && (t <= config.max_dist); step++) {
+        float distance = evaluate(ray.position + ray.direction * t,config);
+        radius = fabs(distance);
+
+        bool relaxation_failed = (omega > 1) && (radius + prev_radius < step_length);
+        if (relaxation_failed) {
+            // Back up and take the step the previous position allowed,
+            // relaxing again from there
+            t -= step_length;
+            step_length = prev_radius;
+            omega = 1;
+            t += step_length;
+            continue;
+        }
+        omega = config.relaxation;
+
+        float threshold = config.min_dist;
+        if (config.adaptive_min_dist) {
+            threshold = std::max(threshold,footprint * t);
+            threshold = std::min(threshold,config.min_dist * config.adaptive_limit);
+        }
+        if (distance < threshold) {
+            hit = true;
+            break;
+        }
+
+        step_length = distance * omega;
+        prev_radius = radius;
+        t += step_length;
+    }
+    ray.position = ray.position + ray.direction * t;
+    if (config.stats != nullptr) {
+        config.stats->rays++;
+        config.stats->steps += step;
+        config.stats->hits  += hit;
+    }
+    if (hit_out != nullptr) {
+        *hit_out = hit;
+    }
+    if (hit) {
         return config.color(ray);
     } else {
         return TUI::RGB{0,0,0};
@@ -55,11 +164,19 @@ struct Camera {
     Vec3 direction;
     Vec3 frustrum_bounds;
 
-    void render(TUI::Canvas& canvas, RenderConfig config) {
+    // Renders into the canvas and, if given a mask, records which pixels'
+    // rays hit something
+    void render(TUI::Canvas& canvas, RenderConfig config, std::vector<bool> *hit_mask = nullptr) {
         Vec3 right = direction.cross({0,0,1}).norm();
         Vec3 up    = direction.cross(right).norm();
         size_t height = canvas.get_height();
         size_t width  = canvas.get_width();
+        // Roughly half the width of a pixel, per unit of distance from
+        // the camera
+        float footprint = frustrum_bounds.x / frustrum_bounds.y / width * 0.5;
+        if (hit_mask != nullptr) {
+            hit_mask->assign(width*height,false);
+        }
         for (size_t y=0; y<height; y++) {
             for (size_t x=0; x<width; x++) {
                 float x_offset = (x - width  * 0.5) / width;
@@ -69,7 +186,15 @@ struct Camera {
                          + up       *(frustrum_bounds.z*z_offset);
                 dir = dir.norm();
                 Ray ray = {position+dir*frustrum_bounds.z,dir};
-                canvas(x,y) = march(ray,config);
+                bool hit;
+                if (config.enhanced) {
+                    canvas(x,y) = sphere_trace(ray,config,footprint,&hit);
+                } else {
+                    canvas(x,y) = march(ray,config,&hit);
+                }
+                if (hit_mask != nullptr) {
+                    (*hit_mask)[y*width+x] = hit;
+                }
             }
         }
     }
@@ -83,32 +208,164 @@ TUI::RGB color(Ray ray) {
     };
 }
 
+// Spheres repeated every 10 units. Positions are measured from the nearest
+// copy of the sphere, rather than from the corner of their cell, so the
+// distance is exact everywhere instead of overestimating near cell edges.
 float dist(Ray ray) {
-    ray.position.x = fmod(ray.position.x,10.0);
-    ray.position.y = fmod(ray.position.y,10.0);
-    ray.position.z = fmod(ray.position.z,10.0);
+    ray.position.x -= 10.0 * floor(ray.position.x * 0.1 + 0.5);
+    ray.position.y -= 10.0 * floor(ray.position.y * 0.1);
+    ray.position.z -= 10.0 * floor(ray.position.z * 0.1 + 0.5);
     return (ray.position - Vec3{0,5,0}).mag() - 1.0;
 }
 
-int main() {
+// A cluster of spheres scattered through the region the camera flies
+// through. The distance is the minimum over every sphere, which makes each
+// evaluation expensive, so time per frame follows the evaluation count.
+int const CLUSTER_SIZE = 256;
+Vec3  cluster_centers[CLUSTER_SIZE];
+float cluster_radii[CLUSTER_SIZE];
+
+void build_cluster() {
+    // A fixed linear congruential generator, so every run gets the same
+    // scene
+    uint32_t state = 12345;
+    auto next = [&state]() {
+        state = state * 1664525 + 1013904223;
+        return (state >> 8) / (float) (1 << 24);
+    };
+    for (int i=0; i<CLUSTER_SIZE; i++) {
+        cluster_centers[i] = {next()*26-8, next()*20+5, next()*12-6};
+        cluster_radii[i]   = next()*0.5+0.3;
+    }
+}
+
+float cluster(Ray ray) {
+    float result = INFINITY;
+    for (int i=0; i<CLUSTER_SIZE; i++) {
+        float distance = (ray.position - cluster_centers[i]).mag() - cluster_radii[i];
+        result = std::min(result,distance);
+    }
+    return result;
+}
+
+// Renders the same camera path with the original marcher and with each of
+// the sphere tracing enhancements, without displaying anything, and reports
+// how much work each did. Images are compared against the original marcher
+// with ten times the step limit, by whether each pixel's ray hit anything,
+// since the scene's colors change too quickly for exact comparisons.
+void bench(Camera start, RenderConfig base, size_t width, size_t height) {
+    struct Scene {
+        char const *name;
+        float(*distance)(Ray);
+    };
+    Scene scenes[] = {
+        {"repeated spheres", dist   },
+        {"sphere cluster",   cluster},
+    };
+    struct Mode {
+        char const *name;
+        bool  enhanced;
+        float relaxation;
+        bool  adaptive;
+    };
+    Mode modes[] = {
+        {"original",               false, 1.0, false},
+        {"over-relaxed",           true,  1.6, false},
+        {"over-relaxed, adaptive", true,  1.6, true },
+    };
+    int const FRAMES = 100;
+
+    for (Scene &scene : scenes) {
+        RenderConfig truth = base;
+        MarchStats truth_stats = {0,0,0,0};
+        truth.distance = scene.distance;
+        truth.step_limit *= 10;
+        truth.stats = &truth_stats;
+
+        std::cout << scene.name << "\n";
+        for (Mode &mode : modes) {
+            TUI::Canvas canvas(width,height);
+            TUI::Canvas reference(width,height);
+            MarchStats stats = {0,0,0,0};
+            RenderConfig config = base;
+            config.distance   = scene.distance;
+            config.enhanced   = mode.enhanced;
+            config.relaxation = mode.relaxation;
+            config.adaptive_min_dist = mode.adaptive;
+            config.stats = &stats;
+
+            Camera cam = start;
+            size_t agreeing = 0;
+            std::vector<bool> hits, reference_hits;
+            std::chrono::duration<double> elapsed(0);
+            for (int frame=0; frame<FRAMES; frame++) {
+                auto begin = std::chrono::steady_clock::now();
+                cam.render(canvas,config,&hits);
+                elapsed += std::chrono::steady_clock::now() - begin;
+
+                cam.render(reference,truth,&reference_hits);
+                for (size_t i=0; i<hits.size(); i++) {
+                    agreeing += (hits[i] == reference_hits[i]);
+                }
+                cam.position.x += 0.1;
+            }
+
+            size_t pixels = width*height*FRAMES;
+            std::cout << "  " << mode.name << ":\n"
+                      << "    " << elapsed.count() * 1e3 / FRAMES << " ms per frame, "
+                      << (double) stats.steps / stats.rays << " steps per pixel, "
+                      << stats.evaluations / FRAMES << " evaluations per frame\n"
+                      << "    " << 100.0 * stats.hits / stats.rays << "% of rays hit, "
+                      << 100.0 * agreeing / pixels << "% agree with the reference" << std::endl;
+        }
+        std::cout << "  reference:\n"
+                  << "    " << (double) truth_stats.steps / truth_stats.rays << " steps per pixel, "
+                  << 100.0 * truth_stats.hits / truth_stats.rays << "% of rays hit" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
     size_t width  = 64;
     size_t height = 32;
     size_t span = 100;
-    TUI::Canvas canvas(width,height);
     Camera cam = {{0,0,0},{0,1,0},{1,1,1}};
     RenderConfig config {
         .distance   = dist,
         .color      = color,
         .min_dist   = 0.1,
         .step_limit = 100,
+        .max_dist   = 100,
     };
 
-    for(int i=0; i< 100; i++){
+    if ( (argc > 1) && (strcmp(argv[1],"--bench") == 0) ) {
+        build_cluster();
+        bench(cam,config,width,height);
+        return 0;
+    }
+
+    // Render with the enhanced sphere tracer
+    config.enhanced = true;
+
+    TUI::Canvas canvas(width,height);
+
+    // Move the camera at a fixed rate, rendering once per wakeup no matter
+    // how many moves came due, so slow frames don't slow the camera down
+    TUI::FrameScheduler scheduler(std::chrono::milliseconds(10));
+    canvas.full_display();
+    int moves = 0;
+    while (moves < 100) {
+        size_t ticks = scheduler.wait();
+        moves += ticks;
+        cam.position.x += 0.1 * ticks;
         cam.render(canvas,config);
-        canvas.display();
+        scheduler.mark(TUI::FrameScheduler::LOGIC);
+
+        std::string output = canvas.lazy_render();
+        scheduler.mark(TUI::FrameScheduler::ENCODE);
+        std::cout << output;
         std::cout.flush();
-        cam.position.x += 0.1;
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        scheduler.mark(TUI::FrameScheduler::WRITE);
     }
+    std::cerr << scheduler.report();
 }
 